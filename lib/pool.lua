@@ -0,0 +1,120 @@
+local socket = require "socket"
+local coroutine = coroutine
+
+-- outbound connection pool keyed by endpoint (host, port),
+-- idle connections are parked by socket.idle, which closes them
+-- at once if the peer goes away
+local pool = {
+    max = 16,     -- default connections per endpoint
+    delay = nil,  -- connect race delay, see socket.connect
+}
+
+local endpoints = {}
+local owner = {} -- id -> endpoint
+
+local function endpoint(host, port)
+    local key = host..":"..port
+    local ep = endpoints[key]
+    if ep == nil then
+        ep = {
+            host = host,
+            port = port,
+            max = pool.max,
+            count = 0,    -- idle and busy connections
+            idle = {},    -- lifo, the warmest first
+            waiting = {}, -- coroutines wait for a free connection
+        }
+        endpoints[key] = ep
+    end
+    return ep
+end
+
+local function wake(ep)
+    local co = table.remove(ep.waiting, 1)
+    if co then
+        assert(coroutine.resume(co))
+    end
+end
+
+local function onidleclose(id)
+    local ep = owner[id]
+    if ep == nil then return end
+    owner[id] = nil
+    for i=#ep.idle,1,-1 do
+        if ep.idle[i] == id then
+            table.remove(ep.idle, i)
+            break
+        end
+    end
+    ep.count = ep.count - 1
+    wake(ep)
+end
+
+function pool.limit(host, port, max)
+    endpoint(host, port).max = max
+end
+
+function pool.acquire(host, port)
+    local ep = endpoint(host, port)
+    while true do
+        local id = table.remove(ep.idle)
+        if id then
+            assert(socket.idle(id, false))
+            return id
+        end
+        if ep.count < ep.max then
+            ep.count = ep.count + 1
+            local id, err = socket.connect(host, port, pool.delay)
+            if id then
+                owner[id] = ep
+                return id
+            else
+                ep.count = ep.count - 1
+                wake(ep)
+                return nil, err
+            end
+        end
+        table.insert(ep.waiting, coroutine.running())
+        coroutine.yield()
+    end
+end
+
+-- give back a healthy connection, keep it warm for next acquire
+function pool.release(id)
+    local ep = owner[id]
+    assert(ep)
+    if socket.idle(id, true, onidleclose) then
+        table.insert(ep.idle, id)
+    else
+        owner[id] = nil
+        ep.count = ep.count - 1
+        socket.close(id)
+    end
+    wake(ep)
+end
+
+-- drop a broken connection, it is not reused
+function pool.close(id)
+    local ep = owner[id]
+    assert(ep)
+    owner[id] = nil
+    ep.count = ep.count - 1
+    socket.close(id)
+    wake(ep)
+end
+
+-- connect ahead of time, so acquire not wait for handshake
+function pool.warm(host, port, n)
+    local ids = {}
+    for i=1,n do
+        local id = pool.acquire(host, port)
+        if not id then break end
+        table.insert(ids, id)
+    end
+    for _, id in ipairs(ids) do
+        pool.release(id)
+    end
+    return #ids
+end
+
+return pool
@@ -13,6 +13,17 @@ local function suspend(s)
     return coroutine.yield() 
 end
 
+-- pop from buffer, and report consumed for read backpressure
+local function pop(s, mode)
+    local buffer = s.buffer
+    local size = buffer:size()
+    local data = buffer:pop(mode)
+    if data then
+        c.consumed(s.id, size - buffer:size())
+    end
+    return data
+end
+
 local function disconnect(id, force)
     local s = socket_pool[id]
     assert(s)
@@ -26,6 +37,15 @@ local LS_EACCEPT  =1
 local LS_ECONNECT =2 
 local LS_ECONNERR =3 
 local LS_ESOCKERR =4
+local LS_EIDLECLOSE =8
+local LS_ESENDFULL =9
+local LS_ESENDREADY =10
+local LS_ESENDDONE =13
+local LS_ESENDDROP =14
+local LS_ETIMER =17
+local LS_ESIGNAL =18
+
+local LS_ERR_NOBUF = -6
 
 local event = {}
 
@@ -35,7 +55,7 @@ event[LS_EREAD] = function(id)
     local data, n = c.read(id)
     if data then
         s.buffer:push(data, n)
-        local data = s.buffer:pop(s.mode)
+        local data = pop(s, s.mode)
         if data then
             wakeup(s.co, data)
         end
@@ -66,19 +86,100 @@ end
 
 event[LS_ESOCKERR] = function(id, err)
     local s = socket_pool[id]
+    if s == nil then return end -- eg evicted before started
     assert(s.id == id)
-    disconnect(c, true)
+    disconnect(id, true)
     wakeup(s.co, nil, c.error(err)) 
 end
 
+event[LS_EIDLECLOSE] = function(id, err)
+    local s = socket_pool[id]
+    if s == nil then return end
+    socket_pool[id] = nil
+    if s.onidleclose then
+        s.onidleclose(id, c.error(err))
+    end
+end
+
+event[LS_ESENDFULL] = function(id)
+    local s = socket_pool[id]
+    if s == nil then return end
+    s.sendfull = true
+end
+
+event[LS_ESENDREADY] = function(id)
+    local s = socket_pool[id]
+    if s == nil then return end
+    s.sendfull = false
+    local co = s.sendwait
+    if co then
+        s.sendwait = nil
+        wakeup(co)
+    end
+end
+
 local socket = {}
 
+-- lightuserdata sent with token is given back here
+local function sent(id, token, ok)
+    local s = socket_pool[id]
+    local f = s and s.onsent or socket.onsent
+    if f then f(id, token, ok) end
+end
+
+event[LS_ESENDDONE] = function(id, token)
+    sent(id, token, true)
+end
+
+event[LS_ESENDDROP] = function(id, token)
+    sent(id, token, false)
+end
+
+-- timer and signal source, err is the times or the signo
+local function source(id, err)
+    local s = socket_pool[id]
+    if s and s.callback then s.callback(id, err) end
+end
+
+event[LS_ETIMER] = source
+event[LS_ESIGNAL] = source
+
+-- ip may be "unix:/path" or "unix:@name" (linux abstract), port is
+-- not used then, same for connect
 function socket.listen(ip, port)
     return c.listen(ip, port)
 end
 
-function socket.connect(ip, port)
-    local id, err, conning = c.connect(ip, port)
+-- delay: if set, race all resolved addresses, staggered by delay ms
+function socket.connect(ip, port, delay)
+    local id, err, conning = c.connect(ip, port, delay)
+    if id then
+        socket.start(id)
+        if conning then
+            local s = socket_pool[id]
+            return suspend(s)
+        else return id end
+    else return nil, c.error(err)
+    end
+end
+
+-- reliable udp, sessions of one port accepted like tcp
+function socket.rudplisten(ip, port)
+    return c.rudplisten(ip, port)
+end
+
+function socket.rudpconnect(ip, port)
+    local id, err = c.rudpconnect(ip, port)
+    if id then
+        socket.start(id)
+        return id
+    else return nil, c.error(err)
+    end
+end
+
+-- data is sent with syn by tcp fast open if the server support
+function socket.connectfast(ip, port, data)
+    local id, err, conning = c.connectfast(ip, port, data)
     if id then
         socket.start(id)
         if conning then
@@ -104,6 +205,24 @@ function socket.start(id, callback)
     end
 end
 
+-- f(id, times) when expired, every interval ms if given, close to stop
+function socket.timer(ms, interval, f)
+    local id, err = c.timer(ms, interval)
+    if not id then return nil, c.error(err) end
+    socket_pool[id] = { id = id, callback = f }
+    return id
+end
+
+-- f(id, signo) for the signals, they are blocked for normal delivery
+function socket.signal(f, ...)
+    local id, err = c.signal(...)
+    if not id then return nil, c.error(err) end
+    socket_pool[id] = { id = id, callback = f }
+    return id
+end
+
+socket.timerset = c.timerset -- id, ms, interval; ms 0 to stop
+
 function socket.bind(id, co)
     local s = socket_pool[id]
     assert(s)
@@ -127,12 +246,38 @@ function socket.readenable(id, enable)
     end
 end
 
+-- park the socket, onclose(id, err) is called if peer close when idle
+function socket.idle(id, idle, onclose)
+    local s = socket_pool[id]
+    assert(s)
+    local ok, err = c.idle(id, idle)
+    if not ok then
+        return nil, err
+    end
+    if idle then
+        s.co = nil
+        s.onidleclose = onclose
+    else
+        s.co = coroutine.running()
+        s.onidleclose = nil
+    end
+    return true
+end
+
+-- f(id, token, ok) is called when data sent with token is written
+-- (ok) or dropped (socket closed), set socket.onsent for all sockets
+function socket.sent(id, f)
+    local s = socket_pool[id]
+    assert(s)
+    s.onsent = f
+end
+
 function socket.read(id, mode)
     local s = socket_pool[id]
     assert(s)
     assert(s.id == id)
     s.mode = mode
-    local data = s.buffer:pop(mode)
+    local data = pop(s, mode)
     if data then
         return data
     else
@@ -140,12 +285,48 @@ function socket.read(id, mode)
     end
 end
 
-function socket.send(id, data, i, j)
-    local err = c.send(id, data, i, j)
-    if err then
+-- return true, full: full means over high watermark, see socket.waitsend
+-- urgent: go before queued bulk data, at message boundary
+-- token: for lightuserdata, it is not freed, but given back by onsent
+function socket.send(id, data, i, j, urgent, token)
+    local err, full = c.send(id, data, i, j, urgent, token)
+    if err == LS_ERR_NOBUF then -- over net budget, dropped
+        return nil, c.error(err)
+    elseif err then
         disconnect(id, true)
         return nil, c.error(err)
-    else return true end
+    else
+        local s = socket_pool[id]
+        if full and s then
+            s.sendfull = true
+        end
+        return true, full
+    end
+end
+
+socket.watermark = c.watermark
+socket.readmark = c.readmark
+socket.budget = c.budget
+socket.memory = c.memory
+socket.acceptstat = c.acceptstat
+socket.busypoll = c.busypoll -- spin us before block, SO_BUSY_POLL us of new sockets
+socket.busystat = c.busystat -- spin us now, hit, miss
+socket.sendquantum = c.sendquantum
+socket.batch = c.batch
+socket.listenopt = c.listenopt -- id, fastopen queue, defer accept sec; nil keep
+socket.rudpconfig = c.rudpconfig -- id, minrto, interval, sndwnd, rcvwnd; 0 keep
+socket.reuse = c.reuse -- true: reuse last closed socket slot first
+socket.clock = c.clock -- monotonic seconds, sub second
+socket.address = c.address -- ip, port, and pid, uid, gid of unix peer
+
+-- wait until the send queue drain below low watermark
+function socket.waitsend(id)
+    local s = socket_pool[id]
+    assert(s)
+    if s.sendfull then
+        s.sendwait = coroutine.running()
+        coroutine.yield()
+    end
 end
 
 function socket.init(cmax)
@@ -157,5 +338,6 @@ end
 
 socket.fini = c.fini
 socket.poll = c.poll
+socket.pollfd = c.pollfd -- fd and deadline ms for host loop, then poll(0)
 
 return socket